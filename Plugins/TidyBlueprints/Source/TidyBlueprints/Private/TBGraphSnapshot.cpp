@@ -0,0 +1,140 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#include "TBGraphSnapshot.h"
+
+#include "EdGraph/EdGraphNode.h"
+#include "EdGraph/EdGraphPin.h"
+
+
+void TBGraphSnapshot::Build(const FGraphPanelSelectionSet& Selection)
+{
+	Reset();
+
+	for (UObject* NodeObj : Selection)
+	{
+		if (UEdGraphNode* Node = Cast<UEdGraphNode>(NodeObj)) AddNode(Node);
+	}
+
+	NumSelected = Nodes.Num();
+
+	// Nodes whose links have been followed. Execution links are only followed from selected nodes,
+	// non-execution links are followed from every node reached through them.
+	TBitArray<> Expanded(true, NumSelected);
+	TArray<int32> PendingNodes;
+	PendingNodes.Reserve(NumSelected);
+	for (int32 NodeIndex = 0; NodeIndex < NumSelected; NodeIndex++) PendingNodes.Add(NodeIndex);
+
+	for (int32 PendingIndex = 0; PendingIndex < PendingNodes.Num(); PendingIndex++)
+	{
+		const int32 NodeIndex = PendingNodes[PendingIndex];
+
+		for (const UEdGraphPin* Pin : Nodes[NodeIndex]->Pins)
+		{
+			const bool bIsExecPin = Pin->PinType.PinCategory == "exec";
+			if (bIsExecPin && NodeIndex >= NumSelected) continue;
+
+			for (const UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				const int32 LinkedIndex = AddNode(LinkedPin->GetOwningNode());
+				Expanded.SetNum(Nodes.Num(), false);
+
+				if (!bIsExecPin && !Expanded[LinkedIndex])
+				{
+					Expanded[LinkedIndex] = true;
+					PendingNodes.Add(LinkedIndex);
+				}
+			}
+		}
+	}
+
+	const int32 NumNodes = Nodes.Num();
+
+	Selected.Init(false, NumNodes);
+	Selected.SetRange(0, NumSelected, true);
+
+	NumPins.SetNumUninitialized(NumNodes);
+	NumExecPins.SetNumUninitialized(NumNodes);
+	ExecuteInputPin.SetNumUninitialized(NumNodes);
+
+	for (TBAdjacency* Adjacency : { &ExecIn, &ExecOut, &DataIn, &DataOut })
+	{
+		Adjacency->Offsets.Reserve(NumNodes + 1);
+	}
+
+	// Nodes are visited in index order, so appending each node's edges directly produces the CSR layout
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; NodeIndex++)
+	{
+		const UEdGraphNode* Node = Nodes[NodeIndex];
+
+		NumPins[NodeIndex] = Node->Pins.Num();
+		NumExecPins[NodeIndex] = 0;
+		ExecuteInputPin[NodeIndex] = INDEX_NONE;
+
+		for (TBAdjacency* Adjacency : { &ExecIn, &ExecOut, &DataIn, &DataOut })
+		{
+			Adjacency->Offsets.Add(Adjacency->Edges.Num());
+		}
+
+		for (int32 PinIndex = 0; PinIndex < Node->Pins.Num(); PinIndex++)
+		{
+			const UEdGraphPin* Pin = Node->Pins[PinIndex];
+			const bool bIsExecPin = Pin->PinType.PinCategory == "exec";
+
+			if (bIsExecPin)
+			{
+				NumExecPins[NodeIndex]++;
+				if (Pin->Direction == EGPD_Input && Pin->PinName == "execute" && ExecuteInputPin[NodeIndex] == INDEX_NONE)
+				{
+					ExecuteInputPin[NodeIndex] = PinIndex;
+				}
+			}
+
+			TBAdjacency* Adjacency = nullptr;
+			if (Pin->Direction == EGPD_Input) Adjacency = bIsExecPin ? &ExecIn : &DataIn;
+			else if (Pin->Direction == EGPD_Output) Adjacency = bIsExecPin ? &ExecOut : &DataOut;
+			if (!Adjacency) continue;
+
+			for (const UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				const UEdGraphNode* LinkedNode = LinkedPin->GetOwningNode();
+				const int32 LinkedIndex = FindNodeIndex(LinkedNode);
+				if (LinkedIndex == INDEX_NONE) continue;
+
+				TBEdge& Edge = Adjacency->Edges.AddDefaulted_GetRef();
+				Edge.Node = LinkedIndex;
+				Edge.LocalPin = PinIndex;
+				Edge.RemotePin = LinkedNode->Pins.IndexOfByKey(LinkedPin);
+			}
+		}
+	}
+
+	for (TBAdjacency* Adjacency : { &ExecIn, &ExecOut, &DataIn, &DataOut })
+	{
+		Adjacency->Offsets.Add(Adjacency->Edges.Num());
+	}
+}
+
+void TBGraphSnapshot::Reset()
+{
+	Nodes.Reset();
+	Selected.Reset();
+	NumSelected = 0;
+	NumPins.Reset();
+	NumExecPins.Reset();
+	ExecuteInputPin.Reset();
+	ExecIn.Reset();
+	ExecOut.Reset();
+	DataIn.Reset();
+	DataOut.Reset();
+	NodeIndices.Reset();
+}
+
+int32 TBGraphSnapshot::AddNode(UEdGraphNode* Node)
+{
+	if (const int32* ExistingIndex = NodeIndices.Find(Node)) return *ExistingIndex;
+
+	const int32 NodeIndex = Nodes.Add(Node);
+	NodeIndices.Add(Node, NodeIndex);
+
+	return NodeIndex;
+}
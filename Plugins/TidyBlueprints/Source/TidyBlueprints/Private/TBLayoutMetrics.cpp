@@ -0,0 +1,408 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#include "TBLayoutMetrics.h"
+
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "EdGraph/EdGraphNode.h"
+#include "EdGraph/EdGraphPin.h"
+#include "EdGraphNode_Comment.h"
+
+
+namespace
+{
+	constexpr double EstimatedNodeWidth = 200.0;
+	constexpr double EstimatedHeaderHeight = 32.0;
+	constexpr double EstimatedPinRowHeight = 24.0;
+
+	// Wires are rotated by this angle before the sweep so that none of them is vertical. Rotation does not change which wires cross.
+	constexpr double SweepRotation = 0.0137;
+
+	// Relative tolerance for positions on the sweep line that are considered equal
+	constexpr double SweepTolerance = 1e-7;
+
+	/**
+	 * Counts the pairs of boxes with overlapping interiors.
+	 * Boxes are swept in order of their left edge while the boxes still open at that edge are kept ordered by their top edge,
+	 * so each box is only tested against the open boxes in its vertical range: O(n log n + n * c) with c such boxes per box.
+	 */
+	int64 CountOverlappingBoxes(const TArray<FBox2D>& Boxes)
+	{
+		TArray<int32> SortedIndices;
+		SortedIndices.SetNumUninitialized(Boxes.Num());
+		for (int32 Index = 0; Index < Boxes.Num(); Index++) SortedIndices[Index] = Index;
+
+		SortedIndices.Sort([&Boxes](int32 IndexA, int32 IndexB)
+			{
+				return Boxes[IndexA].Min.X < Boxes[IndexB].Min.X;
+			});
+
+		// A box can only overlap open boxes whose top edge is at most this far above its own
+		double MaxHeight = 0.0;
+		for (const FBox2D& Box : Boxes) MaxHeight = FMath::Max(MaxHeight, Box.Max.Y - Box.Min.Y);
+
+		auto IsAbove = [&Boxes](int32 ActiveIndex, double Y)
+			{
+				return Boxes[ActiveIndex].Min.Y < Y;
+			};
+
+		int64 NumOverlaps = 0;
+		TArray<int32> ActiveIndices;
+
+		for (const int32 Index : SortedIndices)
+		{
+			const FBox2D& Box = Boxes[Index];
+
+			for (int32 ActiveIndex = Algo::LowerBound(ActiveIndices, Box.Min.Y - MaxHeight, IsAbove); ActiveIndex < ActiveIndices.Num();)
+			{
+				const FBox2D& ActiveBox = Boxes[ActiveIndices[ActiveIndex]];
+				if (ActiveBox.Min.Y >= Box.Max.Y) break;
+
+				// Closed before this box starts, so it cannot overlap any later box either
+				if (ActiveBox.Max.X <= Box.Min.X)
+				{
+					ActiveIndices.RemoveAt(ActiveIndex, 1, false);
+					continue;
+				}
+
+				if (Box.Min.Y < ActiveBox.Max.Y && ActiveBox.Min.X < Box.Max.X) NumOverlaps++;
+				ActiveIndex++;
+			}
+
+			ActiveIndices.Insert(Index, Algo::LowerBound(ActiveIndices, Box.Min.Y, IsAbove));
+		}
+
+		return NumOverlaps;
+	}
+
+	/**
+	 * Checks whether two wires cross. Wires which only touch, such as wires sharing a pin, do not count.
+	 */
+	bool DoWiresCross(const TBWire& WireA, const TBWire& WireB)
+	{
+		const double OrientationA1 = FVector2D::CrossProduct(WireA.End - WireA.Start, WireB.Start - WireA.Start);
+		const double OrientationA2 = FVector2D::CrossProduct(WireA.End - WireA.Start, WireB.End - WireA.Start);
+		const double OrientationB1 = FVector2D::CrossProduct(WireB.End - WireB.Start, WireA.Start - WireB.Start);
+		const double OrientationB2 = FVector2D::CrossProduct(WireB.End - WireB.Start, WireA.End - WireB.Start);
+
+		return OrientationA1 * OrientationA2 < 0.0 && OrientationB1 * OrientationB2 < 0.0;
+	}
+
+	/**
+	 * A wire rotated by SweepRotation, with its left end first.
+	 */
+	struct TBSweepSegment
+	{
+		FVector2D Left;
+		FVector2D Right;
+		double Slope;
+	};
+
+	enum class SweepEventType : uint8
+	{
+		// Ordered so that at the same position crossings are handled before segments end, and segments end before new ones start
+		CROSSING,
+		END,
+		START
+	};
+
+	struct TBSweepEvent
+	{
+		FVector2D Position;
+		SweepEventType Type;
+		int32 SegmentA;
+		int32 SegmentB;
+
+		bool operator<(const TBSweepEvent& Other) const
+		{
+			if (Position.X != Other.Position.X) return Position.X < Other.Position.X;
+			if (Type != Other.Type) return Type < Other.Type;
+			return Position.Y < Other.Position.Y;
+		}
+	};
+
+	/**
+	 * Counts the pairs of wires which cross with a Bentley-Ottmann sweep: O((n + k) log n) for n wires and k crossings,
+	 * plus the shifting of the sorted array holding the wires under the sweep line.
+	 * All wires crossing at the same point are handled together, so crossings of three or more wires are counted correctly.
+	 */
+	int64 CountWireCrossings(const TArray<TBWire>& Wires)
+	{
+		const double RotationCos = FMath::Cos(SweepRotation);
+		const double RotationSin = FMath::Sin(SweepRotation);
+
+		TArray<TBSweepSegment> Segments;
+		Segments.SetNumUninitialized(Wires.Num());
+
+		TArray<TBSweepEvent> Events;
+		Events.Reserve(Wires.Num() * 2);
+
+		for (int32 WireIndex = 0; WireIndex < Wires.Num(); WireIndex++)
+		{
+			FVector2D Start(Wires[WireIndex].Start.X * RotationCos - Wires[WireIndex].Start.Y * RotationSin, Wires[WireIndex].Start.X * RotationSin + Wires[WireIndex].Start.Y * RotationCos);
+			FVector2D End(Wires[WireIndex].End.X * RotationCos - Wires[WireIndex].End.Y * RotationSin, Wires[WireIndex].End.X * RotationSin + Wires[WireIndex].End.Y * RotationCos);
+			if (End.X < Start.X) Swap(Start, End);
+
+			TBSweepSegment& Segment = Segments[WireIndex];
+			Segment.Left = Start;
+			Segment.Right = End;
+			Segment.Slope = End.X > Start.X ? (End.Y - Start.Y) / (End.X - Start.X) : 0.0;
+
+			// Zero length wires cannot cross anything
+			if (End.X <= Start.X) continue;
+
+			Events.HeapPush({ Start, SweepEventType::START, WireIndex, INDEX_NONE });
+			Events.HeapPush({ End, SweepEventType::END, WireIndex, INDEX_NONE });
+		}
+
+		double SweepX = 0.0;
+
+		auto GetYOnSweepLine = [&Segments, &SweepX](int32 SegmentIndex)
+			{
+				const TBSweepSegment& Segment = Segments[SegmentIndex];
+				return Segment.Left.Y + (FMath::Clamp(SweepX, Segment.Left.X, Segment.Right.X) - Segment.Left.X) * Segment.Slope;
+			};
+
+		auto IsNearlyEqual = [](double A, double B)
+			{
+				return FMath::Abs(A - B) <= SweepTolerance * (1.0 + FMath::Abs(A));
+			};
+
+		// Order of the segments on the sweep line by Y. Segments meeting on the line are ordered as just past it.
+		auto IsOrderedBefore = [&Segments, &GetYOnSweepLine, &IsNearlyEqual](int32 SegmentA, int32 SegmentB)
+			{
+				const double YA = GetYOnSweepLine(SegmentA);
+				const double YB = GetYOnSweepLine(SegmentB);
+				if (!IsNearlyEqual(YA, YB)) return YA < YB;
+				if (Segments[SegmentA].Slope != Segments[SegmentB].Slope) return Segments[SegmentA].Slope < Segments[SegmentB].Slope;
+				return SegmentA < SegmentB;
+			};
+
+		TArray<int32> ActiveSegments;
+
+		// Pairs which are known to cross. Every crossing pair becomes adjacent on the sweep line before it crosses, or meets in a multi-wire crossing.
+		TSet<uint64> CrossingPairs;
+
+		auto MakePairKey = [](int32 SegmentA, int32 SegmentB)
+			{
+				return (uint64(FMath::Min(SegmentA, SegmentB)) << 32) | uint32(FMath::Max(SegmentA, SegmentB));
+			};
+
+		auto FindActiveSegment = [&ActiveSegments, &IsOrderedBefore](int32 SegmentIndex)
+			{
+				const int32 Position = Algo::LowerBound(ActiveSegments, SegmentIndex, IsOrderedBefore);
+				if (ActiveSegments.IsValidIndex(Position) && ActiveSegments[Position] == SegmentIndex) return Position;
+
+				// Rounding can break the order of segments meeting on the sweep line
+				return ActiveSegments.Find(SegmentIndex);
+			};
+
+		auto CheckNeighbours = [&](int32 PositionA, int32 PositionB)
+			{
+				if (!ActiveSegments.IsValidIndex(PositionA) || !ActiveSegments.IsValidIndex(PositionB)) return;
+
+				const int32 SegmentA = ActiveSegments[PositionA];
+				const int32 SegmentB = ActiveSegments[PositionB];
+				const uint64 PairKey = MakePairKey(SegmentA, SegmentB);
+				if (CrossingPairs.Contains(PairKey) || !DoWiresCross(Wires[SegmentA], Wires[SegmentB])) return;
+
+				CrossingPairs.Add(PairKey);
+
+				const TBSweepSegment& A = Segments[SegmentA];
+				const TBSweepSegment& B = Segments[SegmentB];
+				const FVector2D DirectionA = A.Right - A.Left;
+				const FVector2D DirectionB = B.Right - B.Left;
+				const double T = FVector2D::CrossProduct(B.Left - A.Left, DirectionB) / FVector2D::CrossProduct(DirectionA, DirectionB);
+				const FVector2D CrossingPosition(FMath::Max(A.Left.X + T * DirectionA.X, SweepX), A.Left.Y + T * DirectionA.Y);
+
+				Events.HeapPush({ CrossingPosition, SweepEventType::CROSSING, SegmentA, SegmentB });
+			};
+
+		while (Events.Num() > 0)
+		{
+			TBSweepEvent Event;
+			Events.HeapPop(Event, false);
+			SweepX = Event.Position.X;
+
+			if (Event.Type == SweepEventType::START)
+			{
+				const int32 Position = Algo::LowerBound(ActiveSegments, Event.SegmentA, IsOrderedBefore);
+				ActiveSegments.Insert(Event.SegmentA, Position);
+				CheckNeighbours(Position - 1, Position);
+				CheckNeighbours(Position, Position + 1);
+			}
+			else if (Event.Type == SweepEventType::END)
+			{
+				const int32 Position = FindActiveSegment(Event.SegmentA);
+				if (Position == INDEX_NONE) continue;
+
+				ActiveSegments.RemoveAt(Position, 1, false);
+				CheckNeighbours(Position - 1, Position);
+			}
+			else
+			{
+				// Gather every crossing at this point
+				TArray<int32, TInlineAllocator<8>> CrossingSegments = { Event.SegmentA, Event.SegmentB };
+				while (Events.Num() > 0 && Events.HeapTop().Type == SweepEventType::CROSSING
+					&& IsNearlyEqual(Event.Position.X, Events.HeapTop().Position.X) && IsNearlyEqual(Event.Position.Y, Events.HeapTop().Position.Y))
+				{
+					TBSweepEvent SamePointEvent;
+					Events.HeapPop(SamePointEvent, false);
+					CrossingSegments.Add(SamePointEvent.SegmentA);
+					CrossingSegments.Add(SamePointEvent.SegmentB);
+				}
+
+				int32 FirstPosition = MAX_int32;
+				int32 LastPosition = INDEX_NONE;
+				for (const int32 SegmentIndex : CrossingSegments)
+				{
+					const int32 Position = FindActiveSegment(SegmentIndex);
+					if (Position == INDEX_NONE) continue;
+
+					FirstPosition = FMath::Min(FirstPosition, Position);
+					LastPosition = FMath::Max(LastPosition, Position);
+				}
+				if (LastPosition == INDEX_NONE) continue;
+
+				// Include segments which pass through or start at the point without being part of a scheduled crossing yet
+				while (FirstPosition > 0 && IsNearlyEqual(Event.Position.Y, GetYOnSweepLine(ActiveSegments[FirstPosition - 1]))) FirstPosition--;
+				while (LastPosition + 1 < ActiveSegments.Num() && IsNearlyEqual(Event.Position.Y, GetYOnSweepLine(ActiveSegments[LastPosition + 1]))) LastPosition++;
+				if (LastPosition <= FirstPosition) continue;
+
+				// Segments meeting at the point which are not neighbours were never tested against each other
+				for (int32 PositionA = FirstPosition; PositionA <= LastPosition; PositionA++)
+				{
+					for (int32 PositionB = PositionA + 1; PositionB <= LastPosition; PositionB++)
+					{
+						const int32 SegmentA = ActiveSegments[PositionA];
+						const int32 SegmentB = ActiveSegments[PositionB];
+						if (DoWiresCross(Wires[SegmentA], Wires[SegmentB])) CrossingPairs.Add(MakePairKey(SegmentA, SegmentB));
+					}
+				}
+
+				// Past the point the segments are ordered by their slopes
+				Algo::Sort(MakeArrayView(ActiveSegments.GetData() + FirstPosition, LastPosition - FirstPosition + 1), [&Segments](int32 SegmentA, int32 SegmentB)
+					{
+						if (Segments[SegmentA].Slope != Segments[SegmentB].Slope) return Segments[SegmentA].Slope < Segments[SegmentB].Slope;
+						return SegmentA < SegmentB;
+					});
+
+				CheckNeighbours(FirstPosition - 1, FirstPosition);
+				CheckNeighbours(LastPosition, LastPosition + 1);
+			}
+		}
+
+		return CrossingPairs.Num();
+	}
+}
+
+void TBLayoutMetrics::Accumulate(const TBLayoutMetrics& Other)
+{
+	NumNodes += Other.NumNodes;
+	NumWires += Other.NumWires;
+	NumWireCrossings += Other.NumWireCrossings;
+	NumNodeOverlaps += Other.NumNodeOverlaps;
+	TotalWireLength += Other.TotalWireLength;
+	MaxWireLength = FMath::Max(MaxWireLength, Other.MaxWireLength);
+	NumBackEdges += Other.NumBackEdges;
+	BoundingBoxArea += Other.BoundingBoxArea;
+}
+
+FString TBLayoutMetrics::ToString() const
+{
+	return FString::Printf(TEXT("Nodes: %d, Wires: %d, Wire crossings: %lld, Node overlaps: %lld, Total wire length: %.0f, Max wire length: %.0f, Back edges: %d, Bounding box area: %.0f"),
+		NumNodes, NumWires, NumWireCrossings, NumNodeOverlaps, TotalWireLength, MaxWireLength, NumBackEdges, BoundingBoxArea);
+}
+
+TBLayoutGeometry TBLayoutGeometry::Build(TArrayView<UEdGraphNode* const> Nodes, TFunctionRef<FVector2D(const UEdGraphNode*)> GetNodeSize,
+	TFunctionRef<FVector2D(const UEdGraphPin*)> GetPinOffset)
+{
+	TBLayoutGeometry Geometry;
+	Geometry.NodeBounds.Reserve(Nodes.Num());
+
+	TMap<const UEdGraphNode*, FVector2D> NodePositions;
+	NodePositions.Reserve(Nodes.Num());
+
+	for (const UEdGraphNode* Node : Nodes)
+	{
+		if (!Node || Node->IsA<UEdGraphNode_Comment>()) continue;
+
+		const FVector2D Position(Node->NodePosX, Node->NodePosY);
+		Geometry.NodeBounds.Add(FBox2D(Position, Position + GetNodeSize(Node)));
+		NodePositions.Add(Node, Position);
+	}
+
+	for (const TPair<const UEdGraphNode*, FVector2D>& NodePosition : NodePositions)
+	{
+		for (const UEdGraphPin* Pin : NodePosition.Key->Pins)
+		{
+			if (Pin->Direction != EGPD_Output) continue;
+
+			for (const UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				const FVector2D* LinkedNodePosition = NodePositions.Find(LinkedPin->GetOwningNode());
+				if (!LinkedNodePosition) continue;
+
+				TBWire& Wire = Geometry.Wires.AddDefaulted_GetRef();
+				Wire.Start = NodePosition.Value + GetPinOffset(Pin);
+				Wire.End = *LinkedNodePosition + GetPinOffset(LinkedPin);
+			}
+		}
+	}
+
+	return Geometry;
+}
+
+FVector2D TBLayoutGeometry::EstimateNodeSize(const UEdGraphNode* Node)
+{
+	int32 NumInputPins = 0;
+	int32 NumOutputPins = 0;
+	for (const UEdGraphPin* Pin : Node->Pins)
+	{
+		if (Pin->bHidden) continue;
+
+		if (Pin->Direction == EGPD_Input) NumInputPins++;
+		else if (Pin->Direction == EGPD_Output) NumOutputPins++;
+	}
+
+	return FVector2D(EstimatedNodeWidth, EstimatedHeaderHeight + EstimatedPinRowHeight * FMath::Max(NumInputPins, NumOutputPins));
+}
+
+FVector2D TBLayoutGeometry::EstimatePinOffset(const UEdGraphPin* Pin)
+{
+	int32 PinRow = 0;
+	for (const UEdGraphPin* OtherPin : Pin->GetOwningNode()->Pins)
+	{
+		if (OtherPin == Pin) break;
+		if (!OtherPin->bHidden && OtherPin->Direction == Pin->Direction) PinRow++;
+	}
+
+	const double PinX = Pin->Direction == EGPD_Input ? 0.0 : EstimatedNodeWidth;
+	return FVector2D(PinX, EstimatedHeaderHeight + EstimatedPinRowHeight * (PinRow + 0.5));
+}
+
+TBLayoutMetrics TBLayoutGeometry::CalculateMetrics() const
+{
+	TBLayoutMetrics Metrics;
+	Metrics.NumNodes = NodeBounds.Num();
+	Metrics.NumWires = Wires.Num();
+
+	FBox2D TotalBounds(ForceInit);
+	for (const FBox2D& Bounds : NodeBounds) TotalBounds += Bounds;
+	if (TotalBounds.bIsValid) Metrics.BoundingBoxArea = TotalBounds.GetArea();
+
+	Metrics.NumNodeOverlaps = CountOverlappingBoxes(NodeBounds);
+
+	for (const TBWire& Wire : Wires)
+	{
+		const double WireLength = FVector2D::Distance(Wire.Start, Wire.End);
+		Metrics.TotalWireLength += WireLength;
+		Metrics.MaxWireLength = FMath::Max(Metrics.MaxWireLength, WireLength);
+
+		if (Wire.End.X < Wire.Start.X) Metrics.NumBackEdges++;
+	}
+
+	Metrics.NumWireCrossings = CountWireCrossings(Wires);
+
+	return Metrics;
+}
@@ -0,0 +1,62 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#include "TBLayoutMetricsCommandlet.h"
+
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "EdGraph/EdGraph.h"
+#include "Engine/Blueprint.h"
+#include "TBLayoutMetrics.h"
+
+
+UTBLayoutMetricsCommandlet::UTBLayoutMetricsCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UTBLayoutMetricsCommandlet::Main(const FString& Params)
+{
+	FString PackagePath = TEXT("/Game");
+	FParse::Value(*Params, TEXT("Path="), PackagePath);
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	FARFilter Filter;
+	Filter.PackagePaths.Add(*PackagePath);
+	Filter.ClassPaths.Add(UBlueprint::StaticClass()->GetClassPathName());
+	Filter.bRecursivePaths = true;
+	Filter.bRecursiveClasses = true;
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+
+	TBLayoutMetrics TotalMetrics;
+	int32 NumGraphs = 0;
+
+	for (const FAssetData& Asset : Assets)
+	{
+		UBlueprint* Blueprint = Cast<UBlueprint>(Asset.GetAsset());
+		if (!Blueprint) continue;
+
+		TArray<UEdGraph*> Graphs;
+		Blueprint->GetAllGraphs(Graphs);
+
+		for (const UEdGraph* Graph : Graphs)
+		{
+			const TBLayoutMetrics Metrics = TBLayoutGeometry::Build(ToRawPtrTArrayUnsafe(Graph->Nodes), &TBLayoutGeometry::EstimateNodeSize,
+				&TBLayoutGeometry::EstimatePinOffset).CalculateMetrics();
+
+			UE_LOG(LogTemp, Display, TEXT("%s: %s"), *Graph->GetPathName(), *Metrics.ToString());
+
+			TotalMetrics.Accumulate(Metrics);
+			NumGraphs++;
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Total of %d graphs in %d blueprints: %s"), NumGraphs, Assets.Num(), *TotalMetrics.ToString());
+
+	return 0;
+}
@@ -2,203 +2,545 @@
 
 #include "TBManagerSubsystem.h"
 
+#include "Async/ParallelFor.h"
 #include "BlueprintEditor.h"
+#include "HAL/IConsoleManager.h"
+#include "K2Node_VariableGet.h"
 #include "SGraphNode.h"
 #include "SGraphPanel.h"
 #include "SGraphPin.h"
 #include "SNodePanel.h"
+#include "ScopedTransaction.h"
+#include "TBUnionFind.h"
 #include "Widgets/Docking/SDockTab.h"
 
+#define LOCTEXT_NAMESPACE "TBManagerSubsystem"
+
+static TAutoConsoleVariable<bool> CVarCalculateLayoutMetrics(
+	TEXT("TidyBlueprints.CalculateLayoutMetrics"),
+	false,
+	TEXT("Measure and log the layout of the tidied nodes before and after each Tidy Up."));
 
 void UTBManagerSubsystem::StartTidyUp()
 {
 	SetBlueprintEditor();
 	SetSelectedNodes();
+	Snapshot.Build(SelectedNodes);
+
+	const bool bCalculateLayoutMetrics = CVarCalculateLayoutMetrics.GetValueOnGameThread();
+	TBLayoutMetrics InitialLayoutMetrics;
+	if (bCalculateLayoutMetrics) InitialLayoutMetrics = CalculateSnapshotLayoutMetrics();
+
+	const FScopedTransaction Transaction(LOCTEXT("TidyUpTransaction", "Tidy Up"));
+	PositionsChange = MakeUnique<TBNodePositionsChange>();
 
 	TBCluster Cluster;
+	Cluster.CollectionIndices.Init(INDEX_NONE, Snapshot.Nodes.Num());
+	int32 StartingNodeIndex = INDEX_NONE;
 
-	for (UObject* NodeObj : SelectedNodes)
+	for (int32 NodeIndex = 0; NodeIndex < Snapshot.NumSelected; NodeIndex++)
 	{
-		UEdGraphNode* Node = Cast<UEdGraphNode>(NodeObj);
-
-		TBNode NodeData = PopulateNodeData(Node);
+		TBNode NodeData = PopulateNodeData(NodeIndex);
 
-		if (IsNodeExecutable(Node))
+		if (IsNodeExecutable(NodeIndex))
 		{
 			TBCollection Collection;
 			Collection.ParentNode = NodeData;
 
 			// Get all non-executable nodes linked to the parent node
-			for (UEdGraphPin* Pin : Node->Pins)
-			{
-				if (Pin->PinType.PinCategory != "exec")
-				{
-					for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
-					{
-						if (Pin->Direction == EGPD_Input) Collection.InputNodes.Add(PopulateNodeData(LinkedPin->GetOwningNode()));
-						else if (Pin->Direction == EGPD_Output) Collection.OutputNodes.Add(PopulateNodeData(LinkedPin->GetOwningNode()));
-						GetChildNodes(LinkedPin->GetOwningNode(), LinkedPin, Collection);
-					}
-				}
-			}
+			GetLinkedDataNodes(NodeIndex, INDEX_NONE, Collection);
 
-			Cluster.Collections.Add(Collection);
+			Cluster.CollectionIndices[NodeIndex] = Cluster.Collections.Add(Collection);
 		}
 
-		if (IsNodeFirstInSequence(Node))
+		if (IsNodeFirstInSequence(NodeIndex))
 		{
-			Cluster.StartingNode = PopulateNodeData(Node);
+			Cluster.StartingNode = NodeData;
+			StartingNodeIndex = NodeIndex;
 			//break;
 		}
 	}
 
 	int32 CollectionIndex = 0;
-	TraverseSequence(Cluster.StartingNode.Node.Get(), CollectionIndex, Cluster);
+	if (StartingNodeIndex != INDEX_NONE) TraverseSequence(StartingNodeIndex, CollectionIndex, Cluster);
 	Cluster.Collections.Sort([](const TBCollection& Col1, const TBCollection& Col2)
 		{
 			return Col1.Index < Col2.Index;
 		});
 
+	ResolveSharedNodeOwnership(Cluster);
+
 	SetCollectionNodePositions(Cluster);
+
+	// Node positions are stored as a single delta record instead of snapshotting every moved node
+	if (PositionsChange->Num() > 0)
+	{
+		UEdGraph* Graph = BlueprintEditor->GetFocusedGraph();
+		Graph->MarkPackageDirty();
+		if (GUndo) GUndo->StoreUndo(Graph, MoveTemp(PositionsChange));
+	}
+	PositionsChange.Reset();
+
+	if (bCalculateLayoutMetrics)
+	{
+		LastLayoutMetrics = CalculateSnapshotLayoutMetrics();
+		UE_LOG(LogTemp, Display, TEXT("Layout before Tidy Up: %s"), *InitialLayoutMetrics.ToString());
+		UE_LOG(LogTemp, Display, TEXT("Layout after Tidy Up: %s"), *LastLayoutMetrics.ToString());
+	}
+
+	CreatedNodes.Reset();
+	Snapshot.Reset();
+}
+
+void UTBManagerSubsystem::MeasureLayout()
+{
+	SetBlueprintEditor();
+	SetSelectedNodes();
+	Snapshot.Build(SelectedNodes);
+
+	LastLayoutMetrics = CalculateSnapshotLayoutMetrics();
+	UE_LOG(LogTemp, Display, TEXT("Layout of the selected nodes: %s"), *LastLayoutMetrics.ToString());
+
+	Snapshot.Reset();
 }
 
-void UTBManagerSubsystem::TraverseSequence(UEdGraphNode* Node, int32& CollectionIndex, TBCluster& Cluster)
+void UTBManagerSubsystem::TraverseSequence(int32 NodeIndex, int32& CollectionIndex, TBCluster& Cluster)
 {
-	if (!SelectedNodes.Contains(Node)) return;
+	if (!Snapshot.Selected[NodeIndex]) return;
 
-	TBCollection* Collection = Cluster.FindCollection(Node);
-	if (Collection->Index == -1) Collection->Index = CollectionIndex++;
+	TBCollection* Collection = Cluster.FindCollection(NodeIndex);
+	if (Collection && Collection->Index == -1) Collection->Index = CollectionIndex++;
 
-	for (const UEdGraphPin* Pin : Node->Pins)
+	for (const TBEdge& Edge : Snapshot.ExecOut.GetEdges(NodeIndex))
 	{
-		if (Pin->Direction == EGPD_Output && Pin->PinType.PinCategory == "exec")
-		{
-			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
-			{
-				TraverseSequence(LinkedPin->GetOwningNode(), CollectionIndex, Cluster);
-			}
-		}
+		TraverseSequence(Edge.Node, CollectionIndex, Cluster);
 	}
 }
 
-void UTBManagerSubsystem::GetChildNodes(UEdGraphNode* Node, UEdGraphPin* InLinkedPin, TBCollection& Collection)
+void UTBManagerSubsystem::GetChildNodes(int32 NodeIndex, int32 InLinkedPin, TBCollection& Collection)
 {
-	if (Node->Pins.Num() < 2) return;
+	if (Snapshot.NumPins[NodeIndex] < 2) return;
 
-	for (UEdGraphPin* Pin : Node->Pins)
+	GetLinkedDataNodes(NodeIndex, InLinkedPin, Collection);
+}
+
+void UTBManagerSubsystem::GetLinkedDataNodes(int32 NodeIndex, int32 SkippedPin, TBCollection& Collection)
+{
+	TArrayView<const TBEdge> InEdges = Snapshot.DataIn.GetEdges(NodeIndex);
+	TArrayView<const TBEdge> OutEdges = Snapshot.DataOut.GetEdges(NodeIndex);
+
+	// Both lists are ordered by pin, merge them so nodes are collected in the order of the node's pins
+	int32 InIndex = 0;
+	int32 OutIndex = 0;
+	while (InIndex < InEdges.Num() || OutIndex < OutEdges.Num())
 	{
-		if (Pin->PinType.PinCategory != "exec")
-		{
-			if (Pin != InLinkedPin)
-			{
-				for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
-				{
-					if (Pin->Direction == EGPD_Input)
-					{
-						Collection.InputNodes.Add(PopulateNodeData(LinkedPin->GetOwningNode()));
-					}
-					else if (Pin->Direction == EGPD_Output)
-					{
-						Collection.OutputNodes.Add(PopulateNodeData(LinkedPin->GetOwningNode()));
-					}
+		const bool bIsInput = OutIndex == OutEdges.Num() || (InIndex < InEdges.Num() && InEdges[InIndex].LocalPin < OutEdges[OutIndex].LocalPin);
+		const TBEdge& Edge = bIsInput ? InEdges[InIndex++] : OutEdges[OutIndex++];
 
-					GetChildNodes(LinkedPin->GetOwningNode(), LinkedPin, Collection);
-				}
-			}
-		}
+		if (Edge.LocalPin == SkippedPin) continue;
+
+		if (bIsInput) Collection.InputNodes.Add(PopulateNodeData(Edge.Node));
+		else Collection.OutputNodes.Add(PopulateNodeData(Edge.Node));
+
+		GetChildNodes(Edge.Node, Edge.RemotePin, Collection);
 	}
 }
 
-TBNode UTBManagerSubsystem::PopulateNodeData(UEdGraphNode* Node)
+TBNode UTBManagerSubsystem::PopulateNodeData(int32 NodeIndex)
 {
+	UEdGraphNode* Node = Snapshot.Nodes[NodeIndex];
+
 	TBNode NodeData;
 	NodeData.Node = TStrongObjectPtr(Node);
 	NodeData.Size = GetNodeWidget(Node)->GetDesiredSize();
+	NodeData.SnapshotIndex = NodeIndex;
 
 	return NodeData;
 }
 
-bool UTBManagerSubsystem::IsNodeFirstInSequence(const UEdGraphNode* Node)
+void UTBManagerSubsystem::ResolveSharedNodeOwnership(TBCluster& Cluster)
 {
-	int32 NumExecutePins = 0;
-	for (const UEdGraphPin* ExecPin : Node->Pins)
+	const int32 NumNodes = Snapshot.Nodes.Num();
+
+	// Parent nodes are placed by their own collection and are never owned by another one
+	TBitArray<> IsParentNode(false, NumNodes);
+	for (int32 CollectionIndex = 0; CollectionIndex < Cluster.Collections.Num(); CollectionIndex++)
+	{
+		const int32 ParentIndex = Cluster.Collections[CollectionIndex].ParentNode.SnapshotIndex;
+		IsParentNode[ParentIndex] = true;
+		Cluster.CollectionIndices[ParentIndex] = CollectionIndex;
+	}
+
+	// Shared getters are copied instead of tying the nodes using them into one component
+	TBitArray<> IsSharedGetter(false, NumNodes);
+	if (SharedNodeOwnershipType == SharedNodeOwnershipType::DUPLICATE_GETTER)
 	{
-		if (ExecPin->PinType.PinCategory == "exec") NumExecutePins++;
+		for (int32 NodeIndex = 0; NodeIndex < NumNodes; NodeIndex++)
+		{
+			if (!IsParentNode[NodeIndex]) IsSharedGetter[NodeIndex] = IsNodeDuplicableGetter(NodeIndex);
+		}
+	}
+
+	TBUnionFind Components(NumNodes);
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; NodeIndex++)
+	{
+		if (IsParentNode[NodeIndex] || IsSharedGetter[NodeIndex]) continue;
+
+		for (const TBEdge& Edge : Snapshot.DataOut.GetEdges(NodeIndex))
+		{
+			if (!IsParentNode[Edge.Node]) Components.Union(NodeIndex, Edge.Node);
+		}
+	}
+
+	// Average position of each component, only needed to find the nearest consumer
+	TArray<FVector2D> ComponentCenters;
+	if (SharedNodeOwnershipType == SharedNodeOwnershipType::NEAREST_CONSUMER)
+	{
+		ComponentCenters.Init(FVector2D::ZeroVector, NumNodes);
+		for (int32 NodeIndex = 0; NodeIndex < NumNodes; NodeIndex++)
+		{
+			if (IsParentNode[NodeIndex]) continue;
+
+			const UEdGraphNode* Node = Snapshot.Nodes[NodeIndex];
+			const int32 Root = Components.Find(NodeIndex);
+			ComponentCenters[Root] += FVector2D(Node->NodePosX, Node->NodePosY) / Components.GetSetSize(Root);
+		}
+	}
+
+	// Index of the owning collection and its score for each component root, lower scores win
+	TArray<int32> ComponentOwners;
+	TArray<double> OwnerScores;
+	ComponentOwners.Init(INDEX_NONE, NumNodes);
+	OwnerScores.Init(TNumericLimits<double>::Max(), NumNodes);
+
+	auto ConsiderOwner = [this, &Cluster, &ComponentCenters, &ComponentOwners, &OwnerScores](int32 Root, int32 CollectionIndex)
+		{
+			const TBCollection& Collection = Cluster.Collections[CollectionIndex];
+
+			// Collections which were not reached by TraverseSequence come last
+			double Score = Collection.Index == -1 ? TNumericLimits<int32>::Max() : Collection.Index;
+			if (SharedNodeOwnershipType == SharedNodeOwnershipType::NEAREST_CONSUMER)
+			{
+				const UEdGraphNode* ParentNode = Collection.ParentNode.Node.Get();
+				Score = FVector2D::DistSquared(FVector2D(ParentNode->NodePosX, ParentNode->NodePosY), ComponentCenters[Root]);
+			}
+
+			if (Score < OwnerScores[Root])
+			{
+				OwnerScores[Root] = Score;
+				ComponentOwners[Root] = CollectionIndex;
+			}
+		};
+
+	// Candidate owners are the parents a component is directly linked to. Collection lists are not used as they
+	// also hold nodes reached through other parents' pins.
+	TBitArray<> IsConsumedByParent(false, NumNodes);
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; NodeIndex++)
+	{
+		if (IsParentNode[NodeIndex]) continue;
+
+		for (const TBEdge& Edge : Snapshot.DataOut.GetEdges(NodeIndex))
+		{
+			if (!IsParentNode[Edge.Node]) continue;
+
+			const int32 Root = Components.Find(NodeIndex);
+			IsConsumedByParent[Root] = true;
+			ConsiderOwner(Root, Cluster.CollectionIndices[Edge.Node]);
+		}
 	}
-	if (Node->Pins.Num() < 3 && NumExecutePins > 0 && NumExecutePins < Node->Pins.Num()) return true;
 
-	for (const UEdGraphPin* Pin : Node->Pins)
+	// Components which do not feed any parent belong to a parent feeding them
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; NodeIndex++)
 	{
-		if (Pin->Direction == EGPD_Input && Pin->PinName == "execute")
+		if (IsParentNode[NodeIndex]) continue;
+
+		const int32 Root = Components.Find(NodeIndex);
+		if (IsConsumedByParent[Root]) continue;
+
+		for (const TBEdge& Edge : Snapshot.DataIn.GetEdges(NodeIndex))
+		{
+			if (IsParentNode[Edge.Node]) ConsiderOwner(Root, Cluster.CollectionIndices[Edge.Node]);
+		}
+	}
+
+	// Shared getters also belong to the collections owning the nodes using them
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; NodeIndex++)
+	{
+		if (!IsSharedGetter[NodeIndex]) continue;
+
+		for (const TBEdge& Edge : Snapshot.DataOut.GetEdges(NodeIndex))
 		{
-			for (const UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			if (IsParentNode[Edge.Node]) continue;
+
+			const int32 ConsumerOwner = ComponentOwners[Components.Find(Edge.Node)];
+			if (ConsumerOwner != INDEX_NONE) ConsiderOwner(NodeIndex, ConsumerOwner);
+		}
+	}
+
+	auto GetOwner = [&Cluster, &IsParentNode, &Components, &ComponentOwners](int32 NodeIndex)
+		{
+			return IsParentNode[NodeIndex] ? Cluster.CollectionIndices[NodeIndex] : ComponentOwners[Components.Find(NodeIndex)];
+		};
+
+	// Keep only the owned nodes in each collection, each of them exactly once
+	TBitArray<> IsNodeClaimed(false, NumNodes);
+	bool bCreatedNodes = false;
+
+	// Nodes found by a collection which does not own them and whether they were found among its inputs.
+	// The owner may not have reached every member of a component itself, so it takes these over afterwards.
+	TArray<TPair<TBNode, bool>> ForeignNodes;
+
+	for (int32 CollectionIndex = 0; CollectionIndex < Cluster.Collections.Num(); CollectionIndex++)
+	{
+		TBCollection& Collection = Cluster.Collections[CollectionIndex];
+		TSet<int32> DuplicatedNodes;
+
+		for (const bool bIsInput : { true, false })
+		{
+			TArray<TBNode>& ChildNodes = bIsInput ? Collection.InputNodes : Collection.OutputNodes;
+			TArray<TBNode> OwnedNodes;
+			OwnedNodes.Reserve(ChildNodes.Num());
+
+			for (const TBNode& ChildNode : ChildNodes)
 			{
-				if (!SelectedNodes.Contains(LinkedPin->GetOwningNode()))
+				const int32 NodeIndex = ChildNode.SnapshotIndex;
+				if (IsParentNode[NodeIndex]) continue;
+
+				const int32 Owner = GetOwner(NodeIndex);
+				if (Owner == CollectionIndex)
 				{
-					return true;
+					if (!IsNodeClaimed[NodeIndex])
+					{
+						IsNodeClaimed[NodeIndex] = true;
+						OwnedNodes.Add(ChildNode);
+					}
+					continue;
 				}
+
+				ForeignNodes.Emplace(ChildNode, bIsInput);
+
+				// The owner keeps the links to its own nodes, the copy takes over the ones of this collection
+				if (!IsSharedGetter[NodeIndex] || Owner == INDEX_NONE || DuplicatedNodes.Contains(NodeIndex)) continue;
+
+				TArray<UEdGraphNode*> Consumers;
+				for (const TBEdge& Edge : Snapshot.DataOut.GetEdges(NodeIndex))
+				{
+					if (GetOwner(Edge.Node) == CollectionIndex) Consumers.AddUnique(Snapshot.Nodes[Edge.Node]);
+				}
+				if (Consumers.Num() == 0) continue;
+
+				DuplicatedNodes.Add(NodeIndex);
+				OwnedNodes.Add(DuplicateGetterForConsumers(CastChecked<UK2Node_VariableGet>(ChildNode.Node.Get()), Consumers, ChildNode.Size));
+				bCreatedNodes = true;
 			}
+
+			ChildNodes = MoveTemp(OwnedNodes);
 		}
 	}
 
+	for (TPair<TBNode, bool>& ForeignNode : ForeignNodes)
+	{
+		const int32 NodeIndex = ForeignNode.Key.SnapshotIndex;
+		const int32 Owner = GetOwner(NodeIndex);
+		if (Owner == INDEX_NONE || IsNodeClaimed[NodeIndex]) continue;
+
+		IsNodeClaimed[NodeIndex] = true;
+		TBCollection& Collection = Cluster.Collections[Owner];
+		(ForeignNode.Value ? Collection.InputNodes : Collection.OutputNodes).Add(MoveTemp(ForeignNode.Key));
+	}
+
+	if (bCreatedNodes) BlueprintEditor->GetFocusedGraph()->NotifyGraphChanged();
+}
+
+bool UTBManagerSubsystem::IsNodeDuplicableGetter(int32 NodeIndex)
+{
+	const UK2Node_VariableGet* Getter = Cast<UK2Node_VariableGet>(Snapshot.Nodes[NodeIndex]);
+	if (!Getter || !Getter->IsNodePure()) return false;
+
+	const UEdGraphPin* ValuePin = Getter->GetValuePin();
+	if (!ValuePin || ValuePin->LinkedTo.Num() < 2) return false;
+
+	for (const UEdGraphPin* Pin : Getter->Pins)
+	{
+		if (Pin != ValuePin && Pin->LinkedTo.Num() > 0) return false;
+	}
+
+	// Several links to the same node are not worth a copy
+	const UEdGraphNode* FirstConsumer = ValuePin->LinkedTo[0]->GetOwningNode();
+	for (const UEdGraphPin* LinkedPin : ValuePin->LinkedTo)
+	{
+		if (LinkedPin->GetOwningNode() != FirstConsumer) return true;
+	}
+
 	return false;
 }
 
-bool UTBManagerSubsystem::IsNodeExecutable(const UEdGraphNode* Node)
+TBNode UTBManagerSubsystem::DuplicateGetterForConsumers(UK2Node_VariableGet* Getter, const TArray<UEdGraphNode*>& Consumers, const FVector2D& Size)
 {
-	int32 NumExecPins = 0;
-	for (const UEdGraphPin* Pin : Node->Pins)
+	UEdGraph* Graph = Getter->GetGraph();
+	Graph->Modify();
+	Getter->Modify();
+	for (UEdGraphNode* Consumer : Consumers) Consumer->Modify();
+
+	FGraphNodeCreator<UK2Node_VariableGet> NodeCreator(*Graph);
+	UK2Node_VariableGet* NewGetter = NodeCreator.CreateNode(false);
+	NewGetter->VariableReference = Getter->VariableReference;
+	NewGetter->NodePosX = Getter->NodePosX;
+	NewGetter->NodePosY = Getter->NodePosY;
+	NodeCreator.Finalize();
+
+	UEdGraphPin* ValuePin = Getter->GetValuePin();
+	UEdGraphPin* NewValuePin = NewGetter->GetValuePin();
+
+	const TArray<UEdGraphPin*> LinkedPins = ValuePin->LinkedTo;
+	for (UEdGraphPin* LinkedPin : LinkedPins)
 	{
-		if (Pin->PinType.PinCategory == "exec") NumExecPins++;
+		if (!Consumers.Contains(LinkedPin->GetOwningNode())) continue;
+
+		ValuePin->BreakLinkTo(LinkedPin);
+		NewValuePin->MakeLinkTo(LinkedPin);
 	}
 
-	return NumExecPins > 0;
+	// The widget of the new node does not exist until the graph panel updates, so reuse the size of the original
+	TBNode NodeData;
+	NodeData.Node = TStrongObjectPtr<UEdGraphNode>(NewGetter);
+	NodeData.Size = Size;
+	CreatedNodes.Add(NodeData);
+
+	return NodeData;
+}
+
+bool UTBManagerSubsystem::IsNodeFirstInSequence(int32 NodeIndex)
+{
+	const int32 NumPins = Snapshot.NumPins[NodeIndex];
+	const int32 NumExecutePins = Snapshot.NumExecPins[NodeIndex];
+	if (NumPins < 3 && NumExecutePins > 0 && NumExecutePins < NumPins) return true;
+
+	const int32 ExecutePin = Snapshot.ExecuteInputPin[NodeIndex];
+	for (const TBEdge& Edge : Snapshot.ExecIn.GetEdges(NodeIndex))
+	{
+		if (Edge.LocalPin == ExecutePin && !Snapshot.Selected[Edge.Node])
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool UTBManagerSubsystem::IsNodeExecutable(int32 NodeIndex)
+{
+	return Snapshot.NumExecPins[NodeIndex] > 0;
 }
 
 void UTBManagerSubsystem::SetNodePosition(UEdGraphNode* Node, const FVector2D& NewPosition)
 {
-	BlueprintEditor->GetFocusedGraph()->GetSchema()->SetNodePosition(Node, NewPosition);
+	const FIntPoint OldPosition(Node->NodePosX, Node->NodePosY);
+
+	// Written directly rather than through the schema so the node is not modified as a whole
+	Node->NodePosX = static_cast<int32>(NewPosition.X);
+	Node->NodePosY = static_cast<int32>(NewPosition.Y);
 	Node->SnapToGrid(SNodePanel::GetSnapGridSize());
+
+	if (PositionsChange) PositionsChange->AddNode(Node, OldPosition, FIntPoint(Node->NodePosX, Node->NodePosY));
 }
 
 void UTBManagerSubsystem::SetCollectionNodePositions(const TBCluster& Cluster)
 {
-	int32 Index = 0;
+	const int32 NumCollections = Cluster.Collections.Num();
+	const double SnapGridSize = SNodePanel::GetSnapGridSize();
+
+	TArray<TBCollectionLayout> Layouts;
+	Layouts.SetNum(NumCollections);
+
+	ParallelFor(NumCollections, [this, &Cluster, &Layouts, SnapGridSize](int32 CollectionIndex)
+		{
+			Layouts[CollectionIndex] = CalculateCollectionLayout(Cluster.Collections[CollectionIndex], SnapGridSize);
+		});
+
+	// Origin of each collection's parent node. Collections which were not reached by TraverseSequence stay where they are.
+	TArray<FVector2D> Origins;
+	Origins.SetNumUninitialized(NumCollections);
+
+	int32 FirstPlacedIndex = 0;
+	for (; FirstPlacedIndex < NumCollections; FirstPlacedIndex++)
+	{
+		const TBCollection& Collection = Cluster.Collections[FirstPlacedIndex];
+		if (Collection.Index != -1) break;
+
+		Origins[FirstPlacedIndex] = FVector2D(Collection.ParentNode.Node.Get()->NodePosX, Collection.ParentNode.Node.Get()->NodePosY);
+	}
 
-	for (const TBCollection& Collection : Cluster.Collections)
+	if (FirstPlacedIndex < NumCollections)
 	{
+		const UEdGraphNode* FirstParentNode = Cluster.Collections[FirstPlacedIndex].ParentNode.Node.Get();
+		const FVector2D StartPosition(FirstParentNode->NodePosX + Layouts[FirstPlacedIndex].Bounds.Min.X, FirstParentNode->NodePosY);
+
+		// Exclusive prefix sum over the collection widths
+		double OffsetX = 0.0;
+		for (int32 CollectionIndex = FirstPlacedIndex; CollectionIndex < NumCollections; CollectionIndex++)
+		{
+			const FBox2D& Bounds = Layouts[CollectionIndex].Bounds;
+			Origins[CollectionIndex] = FVector2D(StartPosition.X + OffsetX - Bounds.Min.X, StartPosition.Y);
+			OffsetX += Bounds.GetSize().X + CollectionPaddingX;
+		}
+	}
+
+	for (int32 CollectionIndex = 0; CollectionIndex < NumCollections; CollectionIndex++)
+	{
+		const TBCollection& Collection = Cluster.Collections[CollectionIndex];
+		const TBCollectionLayout& Layout = Layouts[CollectionIndex];
+		const FVector2D Origin = FVector2D(FMath::GridSnap(Origins[CollectionIndex].X, SnapGridSize), FMath::GridSnap(Origins[CollectionIndex].Y, SnapGridSize));
+
+		if (CollectionIndex >= FirstPlacedIndex) SetNodePosition(Collection.ParentNode.Node.Get(), Origin);
+
 		for (int32 i = 0; i < Collection.InputNodes.Num(); i++)
 		{
-			if (CollectionLayoutType == CollectionLayoutType::STACKED)
-			{
-				FVector2D TargetPosition(Collection.ParentNode.Node.Get()->NodePosX,
-					Collection.ParentNode.Node.Get()->NodePosY + Collection.ParentNode.Size.Y + CollectionNodesPaddingY);
+			SetNodePosition(Collection.InputNodes[i].Node.Get(), Origin + Layout.InputNodeOffsets[i]);
+		}
+	}
+}
 
-				if (i - 1 > -1)
-				{
-					TargetPosition = FVector2D(Collection.InputNodes[i - 1].Node.Get()->NodePosX,
-						Collection.InputNodes[i - 1].Node.Get()->NodePosY + Collection.InputNodes[i - 1].Size.Y + CollectionNodesPaddingY);
-				}
+TBCollectionLayout UTBManagerSubsystem::CalculateCollectionLayout(const TBCollection& Collection, double SnapGridSize) const
+{
+	TBCollectionLayout Layout;
+	Layout.InputNodeOffsets.Reserve(Collection.InputNodes.Num());
+	Layout.Bounds += FBox2D(FVector2D::ZeroVector, Collection.ParentNode.Size);
 
-				SetNodePosition(Collection.InputNodes[i].Node.Get(), TargetPosition);
-			}
-			else if (CollectionLayoutType == CollectionLayoutType::LIST)
-			{
-				FVector2D TargetPosition(Collection.ParentNode.Node.Get()->NodePosX - Collection.InputNodes[i].Size.X - CollectionNodesPaddingX,
-					Collection.ParentNode.Node.Get()->NodePosY + Collection.ParentNode.Size.Y / 2 + CollectionNodesPaddingY);
+	for (int32 i = 0; i < Collection.InputNodes.Num(); i++)
+	{
+		FVector2D TargetOffset = FVector2D::ZeroVector;
 
-				if (i - 1 > -1)
-				{
-					TargetPosition = FVector2D(Collection.InputNodes[i - 1].Node.Get()->NodePosX - Collection.InputNodes[i].Size.X - CollectionNodesPaddingX,
-						Collection.InputNodes[i - 1].Node.Get()->NodePosY + CollectionNodesPaddingY);
-				}
+		if (CollectionLayoutType == CollectionLayoutType::STACKED)
+		{
+			TargetOffset = FVector2D(0.0, Collection.ParentNode.Size.Y + CollectionNodesPaddingY);
+
+			if (i - 1 > -1)
+			{
+				TargetOffset = FVector2D(Layout.InputNodeOffsets[i - 1].X,
+					Layout.InputNodeOffsets[i - 1].Y + Collection.InputNodes[i - 1].Size.Y + CollectionNodesPaddingY);
+			}
+		}
+		else if (CollectionLayoutType == CollectionLayoutType::LIST)
+		{
+			TargetOffset = FVector2D(-Collection.InputNodes[i].Size.X - CollectionNodesPaddingX,
+				Collection.ParentNode.Size.Y / 2 + CollectionNodesPaddingY);
 
-				SetNodePosition(Collection.InputNodes[i].Node.Get(), TargetPosition);
+			if (i - 1 > -1)
+			{
+				TargetOffset = FVector2D(Layout.InputNodeOffsets[i - 1].X - Collection.InputNodes[i].Size.X - CollectionNodesPaddingX,
+					Layout.InputNodeOffsets[i - 1].Y + CollectionNodesPaddingY);
 			}
 		}
 
-		Index++;
+		// Match the truncation and snapping applied by SetNodePosition, as following nodes are placed relative to this one
+		TargetOffset = FVector2D(FMath::GridSnap(FMath::TruncToFloat(TargetOffset.X), SnapGridSize), FMath::GridSnap(FMath::TruncToFloat(TargetOffset.Y), SnapGridSize));
+
+		Layout.InputNodeOffsets.Add(TargetOffset);
+		Layout.Bounds += FBox2D(TargetOffset, TargetOffset + Collection.InputNodes[i].Size);
 	}
+
+	return Layout;
 }
 
 void UTBManagerSubsystem::SetBlueprintEditor()
@@ -233,6 +575,52 @@ void UTBManagerSubsystem::SetSelectedNodes()
 	SelectedNodes = BlueprintEditor->GetSelectedNodes();
 }
 
+TBLayoutMetrics UTBManagerSubsystem::CalculateSnapshotLayoutMetrics()
+{
+	SGraphPanel* GraphPanel = GetCurrentGraphPanel();
+
+	// Widgets are resolved once per node rather than once per pin
+	TMap<const UEdGraphNode*, FVector2D> NodeSizes;
+	TMap<const UEdGraphPin*, FVector2D> PinOffsets;
+	NodeSizes.Reserve(Snapshot.Nodes.Num() + CreatedNodes.Num());
+
+	for (const UEdGraphNode* Node : Snapshot.Nodes)
+	{
+		TSharedPtr<SGraphNode> NodeWidget = GraphPanel->GetNodeWidgetFromGuid(Node->NodeGuid);
+		if (!NodeWidget.IsValid()) continue;
+
+		NodeSizes.Add(Node, NodeWidget->GetDesiredSize());
+
+		TArray<TSharedRef<SWidget>> PinWidgets;
+		NodeWidget->GetPins(PinWidgets);
+		for (const TSharedRef<SWidget>& PinWidget : PinWidgets)
+		{
+			const TSharedRef<SGraphPin> GraphPinWidget = StaticCastSharedRef<SGraphPin>(PinWidget);
+			PinOffsets.Add(GraphPinWidget->GetPinObj(), GraphPinWidget->GetNodeOffset());
+		}
+	}
+
+	// Created getters have no widget until the graph panel updates, use the size of the getter they were copied from
+	TArray<UEdGraphNode*> MeasuredNodes = Snapshot.Nodes;
+	for (const TBNode& CreatedNode : CreatedNodes)
+	{
+		MeasuredNodes.Add(CreatedNode.Node.Get());
+		NodeSizes.Add(CreatedNode.Node.Get(), CreatedNode.Size);
+	}
+
+	return TBLayoutGeometry::Build(MeasuredNodes,
+		[&NodeSizes](const UEdGraphNode* Node)
+		{
+			const FVector2D* Size = NodeSizes.Find(Node);
+			return Size ? *Size : TBLayoutGeometry::EstimateNodeSize(Node);
+		},
+		[&PinOffsets](const UEdGraphPin* Pin)
+		{
+			const FVector2D* Offset = PinOffsets.Find(Pin);
+			return Offset ? *Offset : TBLayoutGeometry::EstimatePinOffset(Pin);
+		}).CalculateMetrics();
+}
+
 SGraphNode* UTBManagerSubsystem::GetNodeWidget(const UEdGraphNode* Node)
 {
 	return GetCurrentGraphPanel()->GetNodeWidgetFromGuid(Node->NodeGuid).Get();
@@ -251,3 +639,5 @@ FVector2D UTBManagerSubsystem::GetExecutableNodeTargetPosition(const TBNode& Nod
 {
 
 }
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,41 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#include "TBNodePositionsChange.h"
+
+#include "EdGraph/EdGraph.h"
+#include "EdGraph/EdGraphNode.h"
+
+
+void TBNodePositionsChange::Apply(UObject* Object)
+{
+	SetNodePositions(Object, NewPositions, false);
+}
+
+void TBNodePositionsChange::Revert(UObject* Object)
+{
+	SetNodePositions(Object, OldPositions, true);
+}
+
+FString TBNodePositionsChange::ToString() const
+{
+	return FString::Printf(TEXT("Tidy Up: moved %d nodes"), Nodes.Num());
+}
+
+void TBNodePositionsChange::SetNodePositions(UObject* Object, const TArray<FIntPoint>& Positions, bool bInReverseOrder)
+{
+	for (int32 i = 0; i < Nodes.Num(); i++)
+	{
+		const int32 NodeIndex = bInReverseOrder ? Nodes.Num() - 1 - i : i;
+		if (UEdGraphNode* Node = Nodes[NodeIndex].Get())
+		{
+			Node->NodePosX = Positions[NodeIndex].X;
+			Node->NodePosY = Positions[NodeIndex].Y;
+		}
+	}
+
+	if (UEdGraph* Graph = Cast<UEdGraph>(Object))
+	{
+		Graph->MarkPackageDirty();
+		Graph->NotifyGraphChanged();
+	}
+}
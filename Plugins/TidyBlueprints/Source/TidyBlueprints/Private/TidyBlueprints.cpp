@@ -48,6 +48,14 @@ void FTidyBlueprintsModule::RegisterNodeMenuItem()
         ));
 
         Section.AddEntry(FToolMenuEntry::InitMenuEntry(FName("TidyUp"), FText::FromString("Tidy Up"), FText::FromString("Start the Tidy Up process"), FSlateIcon(), TidyUpAction));
+
+        FToolUIActionChoice MeasureLayoutAction(FExecuteAction::CreateLambda([]()
+            {
+                if (GEditor) GEditor->GetEditorSubsystem<UTBManagerSubsystem>()->MeasureLayout();
+            }
+        ));
+
+        Section.AddEntry(FToolMenuEntry::InitMenuEntry(FName("MeasureLayout"), FText::FromString("Measure Layout"), FText::FromString("Log the wire crossings, node overlaps and size of the selected nodes' layout"), FSlateIcon(), MeasureLayoutAction));
     }
 }
 
@@ -0,0 +1,107 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GraphEditor.h"
+
+class UEdGraphNode;
+
+/**
+ * A link between two pins, seen from one of the nodes it connects.
+ */
+struct TBEdge
+{
+	// Index of the node on the other end of the link
+	int32 Node;
+
+	// Index of the pin on this node
+	int32 LocalPin;
+
+	// Index of the pin on the other node
+	int32 RemotePin;
+};
+
+/**
+ * Links of one kind stored in compressed sparse row form.
+ * The edges of node N are Edges[Offsets[N]] up to Edges[Offsets[N + 1]], ordered by LocalPin.
+ */
+class TBAdjacency
+{
+public:
+	TArray<int32> Offsets;
+
+	TArray<TBEdge> Edges;
+
+public:
+	TArrayView<const TBEdge> GetEdges(int32 NodeIndex) const
+	{
+		return MakeArrayView(Edges.GetData() + Offsets[NodeIndex], Offsets[NodeIndex + 1] - Offsets[NodeIndex]);
+	}
+
+	void Reset()
+	{
+		Offsets.Reset();
+		Edges.Reset();
+	}
+};
+
+/**
+ * Flat copy of the links around the selected nodes, built once per tidy so that traversals
+ * work on integer arrays instead of walking pins and looking up the selection set.
+ *
+ * Contains every selected node, every node reachable from them through non-execution pins and
+ * every node directly linked to a selected node through an execution pin.
+ * Selected nodes always occupy the first NumSelected indices, in selection set order.
+ */
+class TBGraphSnapshot
+{
+public:
+	TArray<UEdGraphNode*> Nodes;
+
+	// Whether the node at the same index is part of the selection
+	TBitArray<> Selected;
+
+	int32 NumSelected;
+
+	TArray<int32> NumPins;
+
+	TArray<int32> NumExecPins;
+
+	// Index of the "execute" input pin of each node, INDEX_NONE if it has none
+	TArray<int32> ExecuteInputPin;
+
+	TBAdjacency ExecIn;
+	TBAdjacency ExecOut;
+	TBAdjacency DataIn;
+	TBAdjacency DataOut;
+
+private:
+	TMap<const UEdGraphNode*, int32> NodeIndices;
+
+public:
+	TBGraphSnapshot()
+		: NumSelected(0)
+	{}
+
+	/**
+	 * Rebuilds the snapshot from the provided selection.
+	 *
+	 * @param Selection Selected nodes in the graph
+	 */
+	void Build(const FGraphPanelSelectionSet& Selection);
+
+	void Reset();
+
+	/**
+	 * @return Index of the node in the snapshot or INDEX_NONE if it is not part of it
+	 */
+	int32 FindNodeIndex(const UEdGraphNode* Node) const
+	{
+		const int32* NodeIndex = NodeIndices.Find(Node);
+		return NodeIndex ? *NodeIndex : INDEX_NONE;
+	}
+
+private:
+	int32 AddNode(UEdGraphNode* Node);
+};
@@ -0,0 +1,104 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UEdGraphNode;
+class UEdGraphPin;
+
+/**
+ * Quality measurements of the layout of a set of nodes, used to compare layouts objectively.
+ */
+class TBLayoutMetrics
+{
+public:
+	int32 NumNodes;
+
+	int32 NumWires;
+
+	// Pairs of wires which cross each other, wires drawn as straight lines between their pins
+	int64 NumWireCrossings;
+
+	// Pairs of nodes whose bounds overlap
+	int64 NumNodeOverlaps;
+
+	double TotalWireLength;
+
+	double MaxWireLength;
+
+	// Wires whose input pin is to the left of their output pin
+	int32 NumBackEdges;
+
+	// Area of the box enclosing all nodes
+	double BoundingBoxArea;
+
+public:
+	TBLayoutMetrics()
+		: NumNodes(0), NumWires(0), NumWireCrossings(0), NumNodeOverlaps(0), TotalWireLength(0.0), MaxWireLength(0.0), NumBackEdges(0), BoundingBoxArea(0.0)
+	{}
+
+	/**
+	 * Adds the metrics of another layout to these, keeping the larger maximum wire length.
+	 */
+	void Accumulate(const TBLayoutMetrics& Other);
+
+	FString ToString() const;
+};
+
+/**
+ * A link drawn between an output pin and an input pin.
+ */
+struct TBWire
+{
+	// Position of the output pin
+	FVector2D Start;
+
+	// Position of the input pin
+	FVector2D End;
+};
+
+/**
+ * Flat copy of the node bounds and wires of a set of nodes, from which layout metrics are calculated.
+ * Does not reference any UObject once built so metrics can be calculated from any thread.
+ */
+class TBLayoutGeometry
+{
+public:
+	TArray<FBox2D> NodeBounds;
+
+	TArray<TBWire> Wires;
+
+public:
+	/**
+	 * Builds the geometry of the provided nodes. Wires are only added when both linked nodes are in the list.
+	 * Comment nodes are skipped as they are meant to contain other nodes.
+	 *
+	 * @param Nodes Nodes to measure
+	 * @param GetNodeSize Returns the size of a node
+	 * @param GetPinOffset Returns the offset of a pin in relation to its owning node
+	 * @return Geometry of the nodes at their current positions
+	 */
+	static TBLayoutGeometry Build(TArrayView<UEdGraphNode* const> Nodes, TFunctionRef<FVector2D(const UEdGraphNode*)> GetNodeSize,
+		TFunctionRef<FVector2D(const UEdGraphPin*)> GetPinOffset);
+
+	/**
+	 * Approximates the size of a node from its pins, for when node widgets are not available.
+	 */
+	static FVector2D EstimateNodeSize(const UEdGraphNode* Node);
+
+	/**
+	 * Approximates the offset of a pin from its index among the visible pins of the same direction,
+	 * for when node widgets are not available.
+	 */
+	static FVector2D EstimatePinOffset(const UEdGraphPin* Pin);
+
+	/**
+	 * Calculates the metrics of the geometry.
+	 * Wire crossings are counted with a Bentley-Ottmann sweep in O((n + k) log n) for n wires and k crossings.
+	 * Node overlaps are counted with a sweep keeping the open nodes ordered by Y, so each node is only tested against nearby nodes.
+	 *
+	 * @return Layout metrics
+	 */
+	TBLayoutMetrics CalculateMetrics() const;
+};
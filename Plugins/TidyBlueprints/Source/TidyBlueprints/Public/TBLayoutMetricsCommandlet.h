@@ -0,0 +1,28 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TBLayoutMetricsCommandlet.generated.h"
+
+/**
+ * Logs the layout metrics of every graph of the blueprints under a content path, so layouts can be compared in bulk.
+ * Node sizes are estimated from their pins as no node widgets exist outside the graph editor.
+ *
+ * Only the layouts as saved are measured. The tidy needs an open blueprint editor and its node widgets,
+ * so it cannot be run here to compare layout modes: tidy the graphs in the editor with each mode and save
+ * them first, or use Measure Layout on a selection for widget-accurate numbers.
+ *
+ * Usage: UnrealEditor-Cmd.exe <Project> -run=TBLayoutMetrics [-Path=/Game]
+ */
+UCLASS()
+class UTBLayoutMetricsCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTBLayoutMetricsCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
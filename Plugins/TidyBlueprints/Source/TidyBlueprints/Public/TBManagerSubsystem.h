@@ -4,9 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "EditorSubsystem.h"
+#include "TBGraphSnapshot.h"
+#include "TBLayoutMetrics.h"
+#include "TBNodePositionsChange.h"
 #include "TBManagerSubsystem.generated.h"
 
 class UEdGraphNode;
+class UK2Node_VariableGet;
 class FBlueprintEditor;
 
 class TBNode
@@ -15,9 +19,12 @@ public:
 	TStrongObjectPtr<UEdGraphNode> Node;
 	FVector2D Size;
 
+	// Index of the node in the graph snapshot, INDEX_NONE for nodes created during the tidy
+	int32 SnapshotIndex;
+
 public:
 	TBNode()
-		: Size(FVector2D::ZeroVector)
+		: Size(FVector2D::ZeroVector), SnapshotIndex(INDEX_NONE)
 	{}
 };
 
@@ -50,6 +57,25 @@ public:
 	int32 CalculatePadding();
 };
 
+/**
+ * Positions of a collection's nodes relative to its parent node, which sits at the origin.
+ * Only depends on the sizes of the nodes so it can be calculated off the game thread.
+ */
+class TBCollectionLayout
+{
+public:
+	// Offset of each input node, in the same order as the collection's input nodes
+	TArray<FVector2D> InputNodeOffsets;
+
+	// Area covered by the parent and input nodes
+	FBox2D Bounds;
+
+public:
+	TBCollectionLayout()
+		: Bounds(ForceInit)
+	{}
+};
+
 /**
  * A sequence of nodes which are connected through pins.
  * It should not include nodes which are not part of the execution flow of the nodes sequence.
@@ -62,15 +88,15 @@ public:
 
 	TArray<TBCollection> Collections;
 
+	// Index in Collections of the collection whose parent is the snapshot node at the same index, INDEX_NONE for other nodes.
+	// Rebuilt by ResolveSharedNodeOwnership once Collections has been reordered.
+	TArray<int32> CollectionIndices;
+
 public:
-	TBCollection* FindCollection(const UEdGraphNode* Node)
+	TBCollection* FindCollection(int32 NodeIndex)
 	{
-		for (TBCollection& Collection : Collections)
-		{
-			if (Collection.ParentNode.Node.Get()->GetUniqueID() == Node->GetUniqueID()) return &Collection;
-		}
-
-		return nullptr;
+		const int32 CollectionIndex = CollectionIndices[NodeIndex];
+		return CollectionIndex != INDEX_NONE ? &Collections[CollectionIndex] : nullptr;
 	}
 };
 
@@ -80,6 +106,21 @@ enum class CollectionLayoutType
 	LIST
 };
 
+/**
+ * Decides which collection places a group of non-executable nodes that feeds several collections.
+ */
+enum class SharedNodeOwnershipType
+{
+	// Collection which comes first in the execution order
+	EARLIEST_CONSUMER,
+
+	// Collection whose parent node is closest to the nodes
+	NEAREST_CONSUMER,
+
+	// Every consumer gets its own copy of shared variable getters, other nodes use EARLIEST_CONSUMER
+	DUPLICATE_GETTER
+};
+
 UCLASS()
 class TIDYBLUEPRINTS_API UTBManagerSubsystem : public UEditorSubsystem
 {
@@ -90,12 +131,29 @@ private:
 
 	FGraphPanelSelectionSet SelectedNodes;
 
+	// Links around the selected nodes, only valid during a tidy as the garbage collector does not see its nodes
+	TBGraphSnapshot Snapshot;
+
+	// Getter copies created by DUPLICATE_GETTER during the current tidy, which are not part of the snapshot
+	TArray<TBNode> CreatedNodes;
+
+	// Undo record of the positions written during the current tidy
+	TUniquePtr<TBNodePositionsChange> PositionsChange;
+
+	// Metrics of the last measured layout, either from MeasureLayout or after a tidy with TidyBlueprints.CalculateLayoutMetrics set
+	TBLayoutMetrics LastLayoutMetrics;
+
 	// Config properties
 	CollectionLayoutType CollectionLayoutType = CollectionLayoutType::STACKED;
 
+	SharedNodeOwnershipType SharedNodeOwnershipType = SharedNodeOwnershipType::EARLIEST_CONSUMER;
+
 	int32 CollectionNodesPaddingX = 3;
 	int32 CollectionNodesPaddingY = 6;
 
+	// Horizontal space between collections placed next to each other
+	int32 CollectionPaddingX = 64;
+
 public:
 
 	/**
@@ -103,44 +161,91 @@ public:
 	 */
 	void StartTidyUp();
 
+	/**
+	 * Measures and logs the layout of the selected nodes and the nodes linked to them, without moving any node.
+	 * Called when Measure Layout button is clicked.
+	 */
+	void MeasureLayout();
+
+	const TBLayoutMetrics& GetLastLayoutMetrics() const
+	{
+		return LastLayoutMetrics;
+	}
+
 private:
 	/**
 	 * Recursively traverse the execution sequence starting from the specified node.
 	 *
-	 * @param Node Starting point
+	 * @param NodeIndex Snapshot index of the starting point
 	 * @param CollectionIndex Index to give each collection in the cluster an index based on the execution order
-	 * @param SelectedNodes Selected nodes in the graph
 	 * @param Cluster Cluster to traverse
 	 */
-	void TraverseSequence(UEdGraphNode* Node, int32& CollectionIndex, TBCluster& Cluster);
+	void TraverseSequence(int32 NodeIndex, int32& CollectionIndex, TBCluster& Cluster);
 
 	/**
 	 * Recursively get all child nodes of a node
 	 *
-	 * @param Node Node to get the child of
-	 * @param InLinkedPin Pin which the node is linked to
+	 * @param NodeIndex Snapshot index of the node to get the child of
+	 * @param InLinkedPin Index of the pin through which the node was reached
 	 * @param Collection Collection to add the node to
 	 */
-	void GetChildNodes(UEdGraphNode* Node, UEdGraphPin* InLinkedPin, TBCollection& Collection);
+	void GetChildNodes(int32 NodeIndex, int32 InLinkedPin, TBCollection& Collection);
+
+	/**
+	 * Adds the nodes linked to the non-execution pins of a node to the collection, in pin order,
+	 * and continues with their child nodes.
+	 *
+	 * @param NodeIndex Snapshot index of the node
+	 * @param SkippedPin Index of a pin whose links are ignored, INDEX_NONE to follow all pins
+	 * @param Collection Collection to add the nodes to
+	 */
+	void GetLinkedDataNodes(int32 NodeIndex, int32 SkippedPin, TBCollection& Collection);
 
-	TBNode PopulateNodeData(UEdGraphNode* Node);
+	TBNode PopulateNodeData(int32 NodeIndex);
+
+	/**
+	 * Makes sure every non-executable node is part of exactly one collection.
+	 * Nodes linked to each other are grouped into components which are assigned as a whole
+	 * to one of the collections using them, based on SharedNodeOwnershipType. The owner also places
+	 * the members it did not reach itself. With DUPLICATE_GETTER shared getters are kept out of
+	 * the components and every other collection using them gets its own copy.
+	 *
+	 * @param Cluster Cluster whose collections have been ordered by TraverseSequence
+	 */
+	void ResolveSharedNodeOwnership(TBCluster& Cluster);
+
+	/**
+	 * Checks whether the node is a pure variable getter whose only links are on its value pin,
+	 * linked to at least two different nodes.
+	 * @return Can be duplicated for each of its consumers
+	 */
+	bool IsNodeDuplicableGetter(int32 NodeIndex);
+
+	/**
+	 * Creates a copy of a variable getter and moves the links to the consumer nodes over to it.
+	 *
+	 * @param Getter Getter to copy
+	 * @param Consumers Nodes whose links should use the copy
+	 * @return Node data of the copy
+	 */
+	TBNode DuplicateGetterForConsumers(UK2Node_VariableGet* Getter, const TArray<UEdGraphNode*>& Consumers, const FVector2D& Size);
 
 	/**
 	 * Checks whether the node is the first node in the selected nodes' execution sequence.
 	 * @return Is first in sequence
 	 */
-	bool IsNodeFirstInSequence(const UEdGraphNode* Node);
+	bool IsNodeFirstInSequence(int32 NodeIndex);
 
 	/**
 	 * Checks whether the node is executable by checking its pins.
 	 * @return Executable
 	 */
-	bool IsNodeExecutable(const UEdGraphNode* Node);
+	bool IsNodeExecutable(int32 NodeIndex);
 
 	/**
-	 * Updates the position of the provided node on the blueprint graph.
+	 * Updates the position of the provided node on the blueprint graph and records it in the undo record.
+	 * The node is not snapshotted by the transaction, so each node should only be moved once per tidy.
 	 *
-	 * @param Graph Current graph
 	 * @param Node Node whose position should be updated
 	 * @param NewPosition New coordinates of the node on the blueprint graph
 	 */
@@ -148,9 +253,21 @@ private:
 
 	/**
 	 * Sets the positions of the nodes of a collection on the blueprint graph.
+	 * The layout of each collection is calculated in parallel, then the collections reached by TraverseSequence
+	 * are placed in a row in execution order, offset by the running sum of the widths of the preceding collections.
 	 */
 	void SetCollectionNodePositions(const TBCluster& Cluster);
 
+	/**
+	 * Calculates the positions of a collection's nodes relative to its parent node.
+	 * Does not access any UObject and is safe to call from worker threads.
+	 *
+	 * @param Collection Collection to lay out
+	 * @param SnapGridSize Grid size the node positions will be snapped to
+	 * @return Layout of the collection
+	 */
+	TBCollectionLayout CalculateCollectionLayout(const TBCollection& Collection, double SnapGridSize) const;
+
 	/**
 	 * Gets the current blueprint editor.
 	 */
@@ -173,6 +290,14 @@ private:
 	 */
 	void SetSelectedNodes();
 
+	/**
+	 * Calculates the layout metrics of the snapshot nodes at their current positions, using their widgets' sizes.
+	 * This covers the selection and every node linked to it which the tidy can move, as well as the getters it created.
+	 *
+	 * @return Layout metrics
+	 */
+	TBLayoutMetrics CalculateSnapshotLayoutMetrics();
+
 	/**
 	 * Gets the slate widget of a graph node.
 	 *
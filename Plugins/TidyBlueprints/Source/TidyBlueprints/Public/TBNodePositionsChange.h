@@ -0,0 +1,60 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Change.h"
+
+class UEdGraphNode;
+
+/**
+ * Undo record of the node positions changed by a tidy.
+ * Only stores the moved nodes and their old and new positions, instead of a full snapshot of every node,
+ * so undo and redo are a single pass writing positions.
+ */
+class TBNodePositionsChange : public FCommandChange
+{
+private:
+	TArray<TWeakObjectPtr<UEdGraphNode>> Nodes;
+
+	TArray<FIntPoint> OldPositions;
+
+	TArray<FIntPoint> NewPositions;
+
+public:
+	/**
+	 * Records a moved node. A node added more than once is restored to its first old position on undo,
+	 * as old positions are written in reverse order.
+	 *
+	 * @param Node Moved node
+	 * @param OldPosition Position of the node before the tidy
+	 * @param NewPosition Position of the node after the tidy
+	 */
+	void AddNode(UEdGraphNode* Node, const FIntPoint& OldPosition, const FIntPoint& NewPosition)
+	{
+		Nodes.Add(Node);
+		OldPositions.Add(OldPosition);
+		NewPositions.Add(NewPosition);
+	}
+
+	int32 Num() const
+	{
+		return Nodes.Num();
+	}
+
+	//~ Begin FCommandChange interface
+	virtual void Apply(UObject* Object) override;
+	virtual void Revert(UObject* Object) override;
+	virtual FString ToString() const override;
+	//~ End FCommandChange interface
+
+private:
+	/**
+	 * Writes the provided positions to the recorded nodes, marks the graph's package as modified and refreshes the graph.
+	 *
+	 * @param Object Graph the change was stored on
+	 * @param Positions Positions in the same order as the recorded nodes
+	 * @param bInReverseOrder Write the last recorded node first
+	 */
+	void SetNodePositions(UObject* Object, const TArray<FIntPoint>& Positions, bool bInReverseOrder);
+};
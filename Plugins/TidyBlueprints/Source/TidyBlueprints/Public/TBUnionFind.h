@@ -0,0 +1,54 @@
+// Copyright 2023 devran. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Disjoint sets over the indices [0, Num) with path halving and union by size.
+ */
+class TBUnionFind
+{
+private:
+	TArray<int32> Parents;
+
+	TArray<int32> Sizes;
+
+public:
+	explicit TBUnionFind(int32 Num)
+	{
+		Parents.SetNumUninitialized(Num);
+		Sizes.Init(1, Num);
+		for (int32 Index = 0; Index < Num; Index++) Parents[Index] = Index;
+	}
+
+	int32 Find(int32 Index)
+	{
+		while (Parents[Index] != Index)
+		{
+			Parents[Index] = Parents[Parents[Index]];
+			Index = Parents[Index];
+		}
+
+		return Index;
+	}
+
+	void Union(int32 IndexA, int32 IndexB)
+	{
+		int32 RootA = Find(IndexA);
+		int32 RootB = Find(IndexB);
+		if (RootA == RootB) return;
+
+		if (Sizes[RootA] < Sizes[RootB]) Swap(RootA, RootB);
+		Parents[RootB] = RootA;
+		Sizes[RootA] += Sizes[RootB];
+	}
+
+	/**
+	 * @return Number of indices in the set containing the index
+	 */
+	int32 GetSetSize(int32 Index)
+	{
+		return Sizes[Find(Index)];
+	}
+};
@@ -43,7 +43,8 @@ public class TidyBlueprints : ModuleRules
 				"ToolMenus",
 				"BlueprintGraph",
 				"UnrealEd",
-				"Kismet"
+				"Kismet",
+				"AssetRegistry"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);